@@ -0,0 +1,5 @@
+# Looked up by name from native code (jni_ai.cpp)
+-keep interface com.mirror2922.ecvl.NativeLib$BatchCallback { *; }
+-keepclassmembers class * implements com.mirror2922.ecvl.NativeLib$BatchCallback {
+    void onBatch(int, java.lang.String[]);
+}
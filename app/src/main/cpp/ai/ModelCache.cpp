@@ -0,0 +1,175 @@
+#include "ModelCache.h"
+#include <android/log.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+using namespace std;
+
+static mutex statsMutex;
+static ModelLoadStats lastStats;
+
+// Source identity stored in a cache's sidecar
+struct SourceKey {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t inode = 0;
+    uint64_t contentHash = 0;
+};
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL) {
+    auto* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool statSource(const string& path, SourceKey& key) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) return false;
+    key.size = (uint64_t)st.st_size;
+    key.mtime = (int64_t)st.st_mtime;
+    key.inode = (uint64_t)st.st_ino;
+    return true;
+}
+
+static bool hashSource(const string& path, uint64_t& hash) {
+    auto source = MappedFile::open(path);
+    if (!source) return false;
+    hash = fnv1a(source->data(), source->size());
+    return true;
+}
+
+static bool readSidecar(const string& cachePath, SourceKey& key) {
+    FILE* f = fopen((cachePath + ".key").c_str(), "r");
+    if (!f) return false;
+    bool ok = fscanf(f, "%" SCNu64 " %" SCNd64 " %" SCNu64 " %" SCNx64,
+                     &key.size, &key.mtime, &key.inode, &key.contentHash) == 4;
+    fclose(f);
+    return ok;
+}
+
+static bool writeSidecar(const string& cachePath, const SourceKey& key) {
+    string keyPath = cachePath + ".key";
+    string tmpPath = keyPath + ".tmp";
+    FILE* f = fopen(tmpPath.c_str(), "w");
+    if (!f) return false;
+    bool ok = fprintf(f, "%" PRIu64 " %" PRId64 " %" PRIu64 " %016" PRIx64 "\n",
+                      key.size, key.mtime, key.inode, key.contentHash) > 0;
+    ok = fclose(f) == 0 && ok;
+    if (ok && rename(tmpPath.c_str(), keyPath.c_str()) == 0) return true;
+    remove(tmpPath.c_str());
+    return false;
+}
+
+shared_ptr<MappedFile> MappedFile::open(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) return nullptr;
+    return shared_ptr<MappedFile>(new MappedFile(addr, (size_t)st.st_size));
+}
+
+MappedFile::~MappedFile() {
+    munmap(addr, length);
+}
+
+string modelCachePath(const string& modelPath, const string& engineOptions) {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%016" PRIx64 ".ort", fnv1a(engineOptions.data(), engineOptions.size()));
+    return modelPath + suffix;
+}
+
+bool isModelCacheValid(const string& modelPath, const string& cachePath) {
+    SourceKey current, recorded;
+    if (!statSource(modelPath, current) || !readSidecar(cachePath, recorded)) return false;
+    if (access(cachePath.c_str(), R_OK) != 0) return false;
+    if (current.size == recorded.size && current.mtime == recorded.mtime && current.inode == recorded.inode) return true;
+
+    // Metadata changed (copied, touched or replaced): fall back to comparing contents
+    if (current.size != recorded.size || !hashSource(modelPath, current.contentHash)) return false;
+    if (current.contentHash != recorded.contentHash) return false;
+    writeSidecar(cachePath, current);
+    return true;
+}
+
+bool commitModelCache(const string& modelPath, const string& tmpPath, const string& cachePath) {
+    SourceKey key;
+    // Drop the old sidecar first so a crash mid-commit never pairs it with the new cache
+    remove((cachePath + ".key").c_str());
+    if (!statSource(modelPath, key) || !hashSource(modelPath, key.contentHash) ||
+        rename(tmpPath.c_str(), cachePath.c_str()) != 0 || !writeSidecar(cachePath, key)) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void discardModelCache(const string& cachePath) {
+    remove((cachePath + ".key").c_str());
+    remove(cachePath.c_str());
+}
+
+// Reads a "<field>: <value> kB" line from /proc/self/status, -1 if unavailable
+static long readStatusKb(const char* field) {
+    FILE* f = fopen("/proc/self/status", "r");
+    if (!f) return -1;
+    long value = -1;
+    char line[256];
+    size_t len = strlen(field);
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, field, len) == 0 && line[len] == ':') {
+            value = strtol(line + len + 1, nullptr, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+ModelLoadProbe beginModelLoad() {
+    ModelLoadProbe probe;
+    // "5" resets VmHWM to the current RSS; may be refused on some kernels/SELinux policies
+    int fd = ::open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        probe.peakReset = write(fd, "5", 1) == 1;
+        close(fd);
+    }
+    probe.rssBeforeKb = readStatusKb("VmRSS");
+    probe.start = chrono::steady_clock::now();
+    return probe;
+}
+
+void reportModelLoad(const string& engine, const string& modelPath, const ModelLoadProbe& probe, bool fromCache) {
+    ModelLoadStats stats;
+    stats.engine = engine;
+    stats.loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - probe.start).count();
+    long rssAfterKb = readStatusKb("VmRSS");
+    if (probe.rssBeforeKb >= 0 && rssAfterKb >= 0) stats.rssDeltaKb = rssAfterKb - probe.rssBeforeKb;
+    long hwmKb = probe.peakReset ? readStatusKb("VmHWM") : -1;
+    if (probe.rssBeforeKb >= 0 && hwmKb >= 0) stats.peakDeltaKb = hwmKb - probe.rssBeforeKb;
+    stats.fromCache = fromCache;
+
+    __android_log_print(ANDROID_LOG_INFO, engine.c_str(), "Loaded %s in %.1f ms (%s), RSS %+ld KB, peak %+ld KB",
+                        modelPath.c_str(), stats.loadMs, fromCache ? "cached" : "source", stats.rssDeltaKb, stats.peakDeltaKb);
+
+    lock_guard<mutex> lock(statsMutex);
+    lastStats = stats;
+}
+
+ModelLoadStats lastModelLoadStats() {
+    lock_guard<mutex> lock(statsMutex);
+    return lastStats;
+}
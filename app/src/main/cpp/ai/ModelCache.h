@@ -0,0 +1,57 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <string>
+
+// Read-only memory mapping of a model file. Pages come from the page cache, so
+// a session built on the mapping does not keep a second copy of the weights.
+class MappedFile {
+public:
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+    ~MappedFile();
+
+    const void* data() const { return addr; }
+    size_t size() const { return length; }
+
+private:
+    MappedFile(void* addr, size_t length) : addr(addr), length(length) {}
+
+    void* addr;
+    size_t length;
+};
+
+// Path of the pre-optimized copy of modelPath, stored next to it and named after the
+// engine options (which must include the runtime version). Its ".key" sidecar records
+// which source contents it was built from.
+std::string modelCachePath(const std::string& modelPath, const std::string& engineOptions);
+
+// True if cachePath was built from the current contents of modelPath. Checks file
+// metadata first and only rehashes the source when the metadata changed.
+bool isModelCacheValid(const std::string& modelPath, const std::string& cachePath);
+
+// Moves a freshly written cache from tmpPath to cachePath and records the source
+// content hash in its sidecar. This is the only place the whole source is hashed.
+bool commitModelCache(const std::string& modelPath, const std::string& tmpPath, const std::string& cachePath);
+
+// Removes a cache and its sidecar
+void discardModelCache(const std::string& cachePath);
+
+// Process memory snapshot taken right before a load starts
+struct ModelLoadProbe {
+    std::chrono::steady_clock::time_point start;
+    long rssBeforeKb = 0;
+    bool peakReset = false; // VmHWM was reset, so the next VmHWM belongs to this load
+};
+
+struct ModelLoadStats {
+    std::string engine;
+    double loadMs = 0;
+    long rssDeltaKb = 0;   // resident memory kept after the load
+    long peakDeltaKb = -1; // transient peak above the starting RSS, -1 if unknown
+    bool fromCache = false;
+};
+
+ModelLoadProbe beginModelLoad();
+// Logs and records load time and memory cost of the model just loaded
+void reportModelLoad(const std::string& engine, const std::string& modelPath, const ModelLoadProbe& probe, bool fromCache);
+ModelLoadStats lastModelLoadStats();
@@ -1,8 +1,14 @@
 #include "YoloDetector.h"
+#include "YoloSegment.h"
+#include "ModelCache.h"
 #include <onnxruntime_cxx_api.h>
+#include <onnxruntime_session_options_config_keys.h>
 #include <onnxruntime_float16.h>
 #include <android/log.h>
 #include <set>
+#include <algorithm>
+#include <future>
+#include <cstdio>
 
 using namespace cv;
 using namespace std;
@@ -23,41 +29,111 @@ OrtDetector::OrtDetector() : isLoaded(false) {
     env = &ort_env;
 }
 
+// Session settings; the model cache key is derived from these as well
+static const int kIntraOpThreads = 4;
+static const GraphOptimizationLevel kOptimizationLevel = GraphOptimizationLevel::ORT_ENABLE_ALL;
+
 OrtDetector::~OrtDetector() {
-    auto* ort_session = (Ort::Session*)session;
-    if (ort_session) delete ort_session;
-    auto* opts = (Ort::SessionOptions*)session_options;
-    if (opts) delete opts;
+    releaseSession();
+}
+
+void OrtDetector::releaseSession() {
+    delete (Ort::Session*)session;
+    session = nullptr;
+    delete (Ort::SessionOptions*)session_options;
+    session_options = nullptr;
+    // The session may reference the mapped bytes directly, so unmap only after it is gone
+    modelBytes.reset();
+    for (const char* name : inputNames) free((void*)name);
+    for (const char* name : outputNames) free((void*)name);
+    inputNames.clear();
+    outputNames.clear();
+    isLoaded = false;
+}
+
+static Ort::SessionOptions* createSessionOptions() {
+    auto* options = new Ort::SessionOptions();
+    options->SetIntraOpNumThreads(kIntraOpThreads);
+    options->SetGraphOptimizationLevel(kOptimizationLevel);
+    // Handle potential backend-specific options here if needed
+    return options;
 }
 
 bool OrtDetector::loadModel(const string& modelPath) {
+    ModelLoadProbe probe = beginModelLoad();
+    releaseSession();
+    auto* ort_env = (Ort::Env*)env;
+
+    // Keyed by everything that shapes the optimized graph, including the runtime version
+    string cacheKey = string("ort=") + OrtGetApiBase()->GetVersionString() +
+                      ";opt=" + to_string((int)kOptimizationLevel) + ";threads=" + to_string(kIntraOpThreads);
+    string cachePath = modelCachePath(modelPath, cacheKey);
+    bool fromCache = false;
+
     try {
-        auto* ort_env = (Ort::Env*)env;
-        auto* options = new Ort::SessionOptions();
-        options->SetIntraOpNumThreads(4);
-        options->SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
-        
-        // Handle potential backend-specific options here if needed
-        session_options = options;
-
-        auto* ort_session = new Ort::Session(*ort_env, modelPath.c_str(), *options);
+        Ort::Session* ort_session = nullptr;
+
+        // 1. Pre-optimized ORT-format model, used in place from the mapping (weights included)
+        if (isModelCacheValid(modelPath, cachePath) && (modelBytes = MappedFile::open(cachePath))) {
+            auto* options = createSessionOptions();
+            session_options = options;
+            options->SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+            options->AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesDirectly, "1");
+            options->AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesForInitializers, "1");
+            try {
+                ort_session = new Ort::Session(*ort_env, modelBytes->data(), modelBytes->size(), *options);
+                fromCache = true;
+            } catch (const Ort::Exception& e) {
+                __android_log_print(ANDROID_LOG_WARN, "OrtDetector", "Discarding model cache %s: %s", cachePath.c_str(), e.what());
+                releaseSession();
+                discardModelCache(cachePath);
+            }
+        }
+
+        // 2. Source model, serializing the optimized graph for the next launch
+        if (!ort_session) {
+            auto* options = createSessionOptions();
+            session_options = options;
+            string tmpPath = cachePath + ".tmp";
+            options->SetOptimizedModelFilePath(tmpPath.c_str());
+            options->AddConfigEntry(kOrtSessionOptionsConfigSaveModelFormat, "ORT");
+            try {
+                ort_session = new Ort::Session(*ort_env, modelPath.c_str(), *options);
+                commitModelCache(modelPath, tmpPath, cachePath);
+            } catch (const Ort::Exception& e) {
+                // Saving can fail (e.g. read-only model directory); caching is best effort
+                __android_log_print(ANDROID_LOG_WARN, "OrtDetector", "Model cache disabled: %s", e.what());
+                remove(tmpPath.c_str());
+                delete options;
+                options = createSessionOptions();
+                session_options = options;
+                ort_session = new Ort::Session(*ort_env, modelPath.c_str(), *options);
+            }
+        }
         session = ort_session;
 
         Ort::AllocatorWithDefaultOptions allocator;
-        inputNames.clear();
-        outputNames.clear();
-        
         auto in_name = ort_session->GetInputNameAllocated(0, allocator);
         inputNames.push_back(strdup(in_name.get()));
-        
-        auto out_name = ort_session->GetOutputNameAllocated(0, allocator);
-        outputNames.push_back(strdup(out_name.get()));
+
+        // Segmentation models expose a second output with the mask prototypes
+        size_t outputCount = std::min<size_t>(ort_session->GetOutputCount(), 2);
+        for (size_t i = 0; i < outputCount; ++i) {
+            auto out_name = ort_session->GetOutputNameAllocated(i, allocator);
+            outputNames.push_back(strdup(out_name.get()));
+        }
+
+        // Input type (FP16 on some GPU/NPU exports) and batch dimension are fixed per model
+        auto input_tensor_info = ort_session->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo();
+        inputIsFp16 = input_tensor_info.GetElementType() == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16;
+        fixedBatch = input_tensor_info.GetShape()[0];
 
         isLoaded = true;
         __android_log_print(ANDROID_LOG_DEBUG, "OrtDetector", "ECVL Model Ready: %s", modelPath.c_str());
+        reportModelLoad("OrtDetector", modelPath, probe, fromCache);
     } catch (const Ort::Exception& e) {
         __android_log_print(ANDROID_LOG_ERROR, "OrtDetector", "Load error: %s", e.what());
-        isLoaded = false;
+        releaseSession();
     }
     return isLoaded;
 }
@@ -67,13 +143,74 @@ void OrtDetector::setBackend(const string& backendName) {
 }
 
 vector<YoloResult> OrtDetector::detect(Mat& frame, float confThreshold, float iouThreshold, const vector<int>& allowedClasses) {
-    vector<YoloResult> results;
-    if (!isLoaded || frame.empty()) return results;
+    vector<Mat> frames{frame};
+    return detectBatch(frames, confThreshold, iouThreshold, allowedClasses)[0];
+}
+
+vector<vector<YoloResult>> OrtDetector::detectBatch(vector<Mat>& frames, float confThreshold, float iouThreshold, const vector<int>& allowedClasses) {
+    vector<vector<YoloResult>> results(frames.size());
+    if (!isLoaded || frames.empty()) return results;
 
     auto* ort_session = (Ort::Session*)session;
     std::set<int> allowedSet(allowedClasses.begin(), allowedClasses.end());
 
-    // 1. Preprocessing
+    // Dynamic-batch models take every frame in one Run, fixed-batch models go chunk by chunk
+    const size_t count = frames.size();
+    const size_t chunk = fixedBatch > 0 ? (size_t)fixedBatch : count;
+    const size_t paddedCount = (count + chunk - 1) / chunk * chunk;
+    const size_t imageSize = 3 * 640 * 640;
+
+    // 1. Preprocessing: all frames in parallel into one contiguous NCHW tensor.
+    // FP16 models (specialized GPU/NPU backends) get only the FP16 tensor, with a
+    // single-frame FP32 scratch buffer per worker for the conversion.
+    vector<float> inputTensorValues(inputIsFp16 ? 0 : paddedCount * imageSize, 0.0f);
+    vector<uint16_t> fp16_values(inputIsFp16 ? paddedCount * imageSize : 0);
+    parallel_for_(Range(0, (int)count), [&](const Range& range) {
+        vector<float> scratch(inputIsFp16 ? imageSize : 0);
+        for (int i = range.start; i < range.end; ++i) {
+            if (frames[i].empty()) continue;
+            float* dst = inputIsFp16 ? scratch.data() : inputTensorValues.data() + i * imageSize;
+            preprocess(frames[i], dst);
+            if (inputIsFp16) {
+                uint16_t* dst16 = fp16_values.data() + i * imageSize;
+                for (size_t k = 0; k < imageSize; ++k) {
+                    dst16[k] = Ort::Float16_t(dst[k]).val;
+                }
+            }
+        }
+    });
+
+    // 2. Inference: decoding of one chunk overlaps the Run of the next
+    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    std::future<void> pendingDecode;
+    for (size_t start = 0; start < count; start += chunk) {
+        int64_t inputShape[] = {(int64_t)chunk, 3, 640, 640};
+        Ort::Value inputTensor(nullptr);
+        if (inputIsFp16) {
+            inputTensor = Ort::Value::CreateTensor<Ort::Float16_t>(memory_info,
+                reinterpret_cast<Ort::Float16_t*>(fp16_values.data() + start * imageSize), chunk * imageSize, inputShape, 4);
+        } else {
+            inputTensor = Ort::Value::CreateTensor<float>(memory_info,
+                inputTensorValues.data() + start * imageSize, chunk * imageSize, inputShape, 4);
+        }
+
+        auto outputTensors = ort_session->Run(Ort::RunOptions{nullptr}, inputNames.data(), &inputTensor, 1, outputNames.data(), outputNames.size());
+
+        if (pendingDecode.valid()) pendingDecode.get();
+        size_t valid = std::min(chunk, count - start);
+        if (start + chunk >= count) {
+            decodeBatch(outputTensors, frames, start, valid, confThreshold, iouThreshold, allowedSet, results);
+        } else {
+            pendingDecode = std::async(std::launch::async, [&, start, valid, outputs = std::move(outputTensors)]() {
+                decodeBatch(outputs, frames, start, valid, confThreshold, iouThreshold, allowedSet, results);
+            });
+        }
+    }
+
+    return results;
+}
+
+void OrtDetector::preprocess(const Mat& frame, float* dst) {
     Mat rgb;
     if (frame.channels() == 4) cvtColor(frame, rgb, COLOR_RGBA2RGB);
     else rgb = frame;
@@ -82,62 +219,43 @@ vector<YoloResult> OrtDetector::detect(Mat& frame, float confThreshold, float io
     resize(rgb, resized, Size(640, 640));
     resized.convertTo(resized, CV_32FC3, 1.0 / 255.0);
 
-    // 2. Dynamic Input Type Handling (Fix for FP16 GPU crash)
-    auto input_type_info = ort_session->GetInputTypeInfo(0);
-    auto input_tensor_info = input_type_info.GetTensorTypeAndShapeInfo();
-    ONNXTensorElementDataType expected_type = input_tensor_info.GetElementType();
-
-    auto memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-    int64_t inputShape[] = {1, 3, 640, 640};
-    
-    Ort::Value inputTensor(nullptr);
-
-    if (expected_type == ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT16) {
-        // Convert FP32 to FP16 for specialized backends (GPU/NPU)
-        vector<uint16_t> fp16_values(1 * 3 * 640 * 640);
-        for (int c = 0; c < 3; ++c) {
-            for (int h = 0; h < 640; ++h) {
-                for (int w = 0; w < 640; ++w) {
-                    float val = resized.at<Vec3f>(h, w)[c];
-                    // Simple FP32 to FP16 bit conversion helper from ORT
-                    fp16_values[c * 640 * 640 + h * 640 + w] = Ort::Float16_t(val).val;
-                }
-            }
-        }
-        inputTensor = Ort::Value::CreateTensor<Ort::Float16_t>(memory_info, 
-            reinterpret_cast<Ort::Float16_t*>(fp16_values.data()), fp16_values.size(), inputShape, 4);
-        
-        auto outputTensors = ort_session->Run(Ort::RunOptions{nullptr}, inputNames.data(), &inputTensor, 1, outputNames.data(), 1);
-        processResults(outputTensors[0], frame, confThreshold, iouThreshold, allowedSet, results);
-    } else {
-        // Standard FP32 path
-        vector<float> inputTensorValues(1 * 3 * 640 * 640);
-        for (int c = 0; c < 3; ++c) {
-            for (int h = 0; h < 640; ++h) {
-                for (int w = 0; w < 640; ++w) {
-                    inputTensorValues[c * 640 * 640 + h * 640 + w] = resized.at<Vec3f>(h, w)[c];
-                }
-            }
-        }
-        inputTensor = Ort::Value::CreateTensor<float>(memory_info, inputTensorValues.data(), inputTensorValues.size(), inputShape, 4);
-        
-        auto outputTensors = ort_session->Run(Ort::RunOptions{nullptr}, inputNames.data(), &inputTensor, 1, outputNames.data(), 1);
-        processResults(outputTensors[0], frame, confThreshold, iouThreshold, allowedSet, results);
+    // Split straight into the tensor's channel planes (HWC -> CHW without a per-pixel loop)
+    vector<Mat> planes;
+    for (int c = 0; c < 3; ++c) {
+        planes.emplace_back(640, 640, CV_32F, dst + c * 640 * 640);
     }
+    split(resized, planes);
+}
 
-    return results;
+void OrtDetector::decodeBatch(const vector<Ort::Value>& outputTensors, vector<Mat>& frames, size_t first, size_t count, float confThreshold, float iouThreshold, const std::set<int>& allowedSet, vector<vector<YoloResult>>& results) {
+    parallel_for_(Range(0, (int)count), [&](const Range& range) {
+        for (int b = range.start; b < range.end; ++b) {
+            if (frames[first + b].empty()) continue;
+            processResults(outputTensors, b, frames[first + b], confThreshold, iouThreshold, allowedSet, results[first + b]);
+        }
+    });
 }
 
-void OrtDetector::processResults(Ort::Value& outputTensor, Mat& frame, float confThreshold, float iouThreshold, const std::set<int>& allowedSet, vector<YoloResult>& results) {
-    float* floatData = outputTensor.GetTensorMutableData<float>();
-    auto outputShape = outputTensor.GetTensorTypeAndShapeInfo().GetShape();
+void OrtDetector::processResults(const vector<Ort::Value>& outputTensors, size_t batchIndex, const Mat& frame, float confThreshold, float iouThreshold, const std::set<int>& allowedSet, vector<YoloResult>& results) {
+    auto outputShape = outputTensors[0].GetTensorTypeAndShapeInfo().GetShape();
 
     int dimensions = (int)outputShape[1]; 
     int rows = (int)outputShape[2];       
+    const float* floatData = outputTensors[0].GetTensorData<float>() + batchIndex * dimensions * rows;
+
+    MaskProtos protos;
+    if (outputTensors.size() > 1) {
+        protos = makeMaskProtos(outputTensors[1].GetTensorData<float>(),
+                                outputTensors[1].GetTensorTypeAndShapeInfo().GetShape());
+        if (protos.data) protos.data += batchIndex * protos.channels * protos.height * protos.width;
+    }
+    // Mask coefficients follow the class scores and must not be scored as classes
+    int classEnd = dimensions - protos.channels;
 
     vector<int> class_ids;
     vector<float> confidences;
     vector<Rect> boxes;
+    vector<int> candidate_rows;
 
     float x_factor = (float)frame.cols / 640.0f;
     float y_factor = (float)frame.rows / 640.0f;
@@ -145,7 +263,7 @@ void OrtDetector::processResults(Ort::Value& outputTensor, Mat& frame, float con
     for (int i = 0; i < rows; ++i) {
         float max_score = 0;
         int class_id = -1;
-        for (int j = 4; j < dimensions; ++j) {
+        for (int j = 4; j < classEnd; ++j) {
             float score = floatData[j * rows + i];
             if (score > max_score) {
                 max_score = score;
@@ -168,6 +286,7 @@ void OrtDetector::processResults(Ort::Value& outputTensor, Mat& frame, float con
                 boxes.push_back(Rect(left, top, width, height));
                 confidences.push_back(max_score);
                 class_ids.push_back(class_id);
+                candidate_rows.push_back(i);
             }
         }
     }
@@ -183,6 +302,11 @@ void OrtDetector::processResults(Ort::Value& outputTensor, Mat& frame, float con
         res.y = boxes[idx].y;
         res.width = boxes[idx].width;
         res.height = boxes[idx].height;
+        if (protos.data) {
+            // Coefficients are decoded lazily, only for boxes kept by NMS
+            const float* coeffs = floatData + (size_t)classEnd * rows + candidate_rows[idx];
+            decodeMask(protos, coeffs, rows, frame.size(), upsampleMasks, res);
+        }
         results.push_back(res);
     }
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "YoloDetector.h"
+#include "YoloSegment.h"
+#include "ModelCache.h"
 #include <android/log.h>
 #include <set>
 
@@ -21,12 +23,16 @@ OpenCVDetector::OpenCVDetector() : isLoaded(false) {
 }
 
 bool OpenCVDetector::loadModel(const string& modelPath) {
+    ModelLoadProbe probe = beginModelLoad();
     try {
+        // OpenCV copies every initializer into its own blobs, so unlike the ORT engine it
+        // cannot read weights from a mapping; only load time and memory are reported
         net = readNet(modelPath);
         net.setPreferableBackend(DNN_BACKEND_OPENCV);
         net.setPreferableTarget(DNN_TARGET_CPU);
         isLoaded = true;
         __android_log_print(ANDROID_LOG_DEBUG, "OpenCVDetector", "Model loaded from %s", modelPath.c_str());
+        reportModelLoad("OpenCVDetector", modelPath, probe, false);
     } catch (const cv::Exception& e) {
         __android_log_print(ANDROID_LOG_ERROR, "OpenCVDetector", "Load error: %s", e.what());
         isLoaded = false;
@@ -71,10 +77,20 @@ vector<YoloResult> OpenCVDetector::detect(Mat& frame, float confThreshold, float
     vector<Mat> outputs;
     net.forward(outputs, net.getUnconnectedOutLayersNames());
 
-    // 3. Post-processing
+    // 3. Post-processing (segmentation models add a 4D prototype output)
     Mat output = outputs[0];
+    MaskProtos protos;
+    for (Mat& out : outputs) {
+        if (out.dims == 4) {
+            protos = makeMaskProtos((const float*)out.data, {out.size[0], out.size[1], out.size[2], out.size[3]});
+        } else {
+            output = out;
+        }
+    }
     int dimensions = output.size[1];
     int rows = output.size[2];
+    // Mask coefficients follow the class scores and must not be scored as classes
+    int maskOffset = dimensions - protos.channels;
 
     Mat out2D = output.reshape(1, dimensions);
     Mat t_output;
@@ -87,6 +103,7 @@ vector<YoloResult> OpenCVDetector::detect(Mat& frame, float confThreshold, float
     vector<int> class_ids;
     vector<float> confidences;
     vector<Rect> boxes;
+    vector<int> candidate_rows;
 
     for (int i = 0; i < rows; ++i) {
         float* row_ptr = data + (i * dimensions);
@@ -94,7 +111,7 @@ vector<YoloResult> OpenCVDetector::detect(Mat& frame, float confThreshold, float
         
         Point classIdPoint;
         double max_class_score;
-        minMaxLoc(Mat(1, classNames.size(), CV_32F, scores_ptr), 0, &max_class_score, 0, &classIdPoint);
+        minMaxLoc(Mat(1, maskOffset - 4, CV_32F, scores_ptr), 0, &max_class_score, 0, &classIdPoint);
         
         if (max_class_score > confThreshold) {
             int classId = classIdPoint.x;
@@ -112,6 +129,7 @@ vector<YoloResult> OpenCVDetector::detect(Mat& frame, float confThreshold, float
                 boxes.push_back(Rect(left, top, width, height));
                 confidences.push_back((float)max_class_score);
                 class_ids.push_back(classId);
+                candidate_rows.push_back(i);
             }
         }
     }
@@ -127,6 +145,11 @@ vector<YoloResult> OpenCVDetector::detect(Mat& frame, float confThreshold, float
         res.y = boxes[idx].y;
         res.width = boxes[idx].width;
         res.height = boxes[idx].height;
+        if (protos.data) {
+            // Coefficients are decoded lazily, only for boxes kept by NMS
+            const float* coeffs = data + (size_t)candidate_rows[idx] * dimensions + maskOffset;
+            decodeMask(protos, coeffs, 1, frame.size(), upsampleMasks, res);
+        }
         results.push_back(res);
     }
 
@@ -3,12 +3,14 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <memory>
 #include "yolo_result.h"
 
 // Forward declaration for ORT
 namespace Ort {
     class Value;
 }
+class MappedFile;
 
 // Base class for different AI backends
 class InferenceEngine {
@@ -17,6 +19,22 @@ public:
     virtual bool loadModel(const std::string& modelPath) = 0;
     virtual void setBackend(const std::string& backendName) = 0;
     virtual std::vector<YoloResult> detect(cv::Mat& frame, float confThreshold, float iouThreshold, const std::vector<int>& allowedClasses) = 0;
+
+    // Detects on several frames at once; engines without native batching run them one by one
+    virtual std::vector<std::vector<YoloResult>> detectBatch(std::vector<cv::Mat>& frames, float confThreshold, float iouThreshold, const std::vector<int>& allowedClasses) {
+        std::vector<std::vector<YoloResult>> results;
+        results.reserve(frames.size());
+        for (cv::Mat& frame : frames) {
+            results.push_back(detect(frame, confThreshold, iouThreshold, allowedClasses));
+        }
+        return results;
+    }
+
+    // Segmentation models: resize masks to the box instead of keeping prototype resolution
+    void setMaskUpsampling(bool enabled) { upsampleMasks = enabled; }
+
+protected:
+    bool upsampleMasks = false;
 };
 
 // Current OpenCV implementation
@@ -43,16 +61,27 @@ public:
     bool loadModel(const std::string& modelPath) override;
     void setBackend(const std::string& backendName) override;
     std::vector<YoloResult> detect(cv::Mat& frame, float confThreshold, float iouThreshold, const std::vector<int>& allowedClasses) override;
+    std::vector<std::vector<YoloResult>> detectBatch(std::vector<cv::Mat>& frames, float confThreshold, float iouThreshold, const std::vector<int>& allowedClasses) override;
 
 private:
-    // Change to take Ort::Value reference properly
-    void processResults(Ort::Value& outputTensor, cv::Mat& frame, float confThreshold, float iouThreshold, const std::set<int>& allowedSet, std::vector<YoloResult>& results);
+    // Frees the session, its options and the mapping it may read weights from.
+    // Like loadModel, not synchronized with detect: ai.cpp only loads engines before publishing them.
+    void releaseSession();
+    // Resizes and normalizes one frame into a planar RGB 640x640 slot of the input tensor
+    void preprocess(const cv::Mat& frame, float* dst);
+    // Decodes `count` images of one Run, starting at frames[first], in parallel
+    void decodeBatch(const std::vector<Ort::Value>& outputTensors, std::vector<cv::Mat>& frames, size_t first, size_t count, float confThreshold, float iouThreshold, const std::set<int>& allowedSet, std::vector<std::vector<YoloResult>>& results);
+    // outputTensors[0] holds detections, outputTensors[1] the mask prototypes of segmentation models
+    void processResults(const std::vector<Ort::Value>& outputTensors, size_t batchIndex, const cv::Mat& frame, float confThreshold, float iouThreshold, const std::set<int>& allowedSet, std::vector<YoloResult>& results);
 
     void* env = nullptr;
     void* session = nullptr;
     void* session_options = nullptr;
+    std::shared_ptr<MappedFile> modelBytes; // cached ORT-format model backing the session
     
     bool isLoaded = false;
+    bool inputIsFp16 = false;
+    int64_t fixedBatch = 1; // <= 0 when the model accepts a dynamic batch dimension
     std::vector<std::string> classNames;
     std::vector<const char*> inputNames;
     std::vector<const char*> outputNames;
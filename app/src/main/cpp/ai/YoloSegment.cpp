@@ -0,0 +1,75 @@
+#include "YoloSegment.h"
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+MaskProtos makeMaskProtos(const float* data, const vector<int64_t>& shape) {
+    MaskProtos protos;
+    if (data == nullptr || shape.size() != 4) return protos;
+    protos.data = data;
+    protos.channels = (int)shape[1];
+    protos.height = (int)shape[2];
+    protos.width = (int)shape[3];
+    return protos;
+}
+
+void decodeMask(const MaskProtos& protos, const float* coeffs, size_t coeffStride,
+                const Size& frameSize, bool upsample, YoloResult& result) {
+    if (protos.data == nullptr) return;
+
+    Rect box = Rect(result.x, result.y, result.width, result.height) & Rect(Point(0, 0), frameSize);
+    if (box.empty()) return;
+    result.x = box.x;
+    result.y = box.y;
+    result.width = box.width;
+    result.height = box.height;
+
+    // Box region on the prototype grid (e.g. 160x160 for a 640 input)
+    float sx = (float)protos.width / frameSize.width;
+    float sy = (float)protos.height / frameSize.height;
+    int x0 = std::clamp(cvRound(box.x * sx), 0, protos.width - 1);
+    int y0 = std::clamp(cvRound(box.y * sy), 0, protos.height - 1);
+    int x1 = std::clamp(cvRound((box.x + box.width) * sx), x0 + 1, protos.width);
+    int y1 = std::clamp(cvRound((box.y + box.height) * sy), y0 + 1, protos.height);
+    Rect roi(x0, y0, x1 - x0, y1 - y0);
+
+    // coeffs x protos restricted to the ROI, accumulated one prototype plane at a time
+    // with SIMD scaleAdd directly on ROI views (no gather, no full-grid product)
+    Mat logits = Mat::zeros(roi.size(), CV_32F);
+    size_t planeSize = (size_t)protos.height * protos.width;
+    for (int c = 0; c < protos.channels; ++c) {
+        Mat plane(protos.height, protos.width, CV_32F, (void*)(protos.data + c * planeSize));
+        scaleAdd(plane(roi), coeffs[c * coeffStride], logits, logits);
+    }
+
+    if (upsample) {
+        resize(logits, logits, box.size(), 0, 0, INTER_LINEAR);
+    }
+
+    // sigmoid(x) > 0.5 <=> x > 0, so the sigmoid itself is never evaluated
+    Mat mask = logits > 0;
+    result.maskWidth = mask.cols;
+    result.maskHeight = mask.rows;
+    result.maskRle = encodeMaskRle(mask);
+}
+
+vector<int> encodeMaskRle(const Mat& mask) {
+    vector<int> runs;
+    bool current = false;
+    int run = 0;
+    for (int y = 0; y < mask.rows; ++y) {
+        const uchar* row = mask.ptr<uchar>(y);
+        for (int x = 0; x < mask.cols; ++x) {
+            bool value = row[x] != 0;
+            if (value != current) {
+                runs.push_back(run);
+                run = 0;
+                current = value;
+            }
+            ++run;
+        }
+    }
+    runs.push_back(run);
+    return runs;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "yolo_result.h"
+
+// Prototype output of a YOLO segmentation head, laid out as [1, channels, height, width]
+struct MaskProtos {
+    const float* data = nullptr;
+    int channels = 0;
+    int height = 0;
+    int width = 0;
+};
+
+// Wraps a 4D network output as prototypes; returns an empty set for anything else
+MaskProtos makeMaskProtos(const float* data, const std::vector<int64_t>& shape);
+
+// Decodes the mask of one detection that survived NMS. The coefficients (read with the
+// given stride) are combined with the prototypes only inside the box's region of the
+// prototype grid. With upsample the mask is resized to the box, otherwise it stays at
+// prototype resolution. The box is clipped to the frame so the mask spans it exactly.
+void decodeMask(const MaskProtos& protos, const float* coeffs, size_t coeffStride,
+                const cv::Size& frameSize, bool upsample, YoloResult& result);
+
+// Run-length encodes a binary CV_8U mask, row-major, starting with a background run
+std::vector<int> encodeMaskRle(const cv::Mat& mask);
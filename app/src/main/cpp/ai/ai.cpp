@@ -1,37 +1,89 @@
 #include "ai.h"
 #include "../utils/utils.h"
 #include <memory>
+#include <mutex>
 #include <android/log.h>
 
 using namespace std;
 
-unique_ptr<InferenceEngine> detector;
-string lastModelPath = "";
+// detectorMutex serializes use of the engine (one frame or one batch per lock) and guards
+// the settings applied to it. Engines are built and loaded aside under loadMutex and only
+// published under detectorMutex, so inference keeps running on the old engine during a load.
+static unique_ptr<InferenceEngine> detector;
+static mutex detectorMutex;
+static mutex loadMutex;
+
+static string engineName = "OpenCV";       // guarded by loadMutex
+static string lastModelPath = "";          // guarded by loadMutex
+static string hardwareBackend = "";        // guarded by detectorMutex
+static bool maskUpsampling = false;        // guarded by detectorMutex
+
+static unique_ptr<InferenceEngine> createEngine(const string& name) {
+    if (name == "ONNXRuntime") return make_unique<OrtDetector>();
+    return make_unique<OpenCVDetector>();
+}
+
+// Loads modelPath into a fresh engine, then swaps it in; the old engine is destroyed outside the lock
+static bool publishEngine(const string& name, const string& modelPath) {
+    auto engine = createEngine(name);
+    bool loaded = !modelPath.empty() && engine->loadModel(modelPath);
+
+    unique_ptr<InferenceEngine> previous;
+    {
+        lock_guard<mutex> lock(detectorMutex);
+        engine->setMaskUpsampling(maskUpsampling);
+        if (!hardwareBackend.empty()) engine->setBackend(hardwareBackend);
+        previous = std::move(detector);
+        detector = std::move(engine);
+    }
+    return loaded;
+}
 
 bool initYolo(const char* modelPath) {
+    lock_guard<mutex> lock(loadMutex);
     lastModelPath = string(modelPath);
-    if (!detector) {
-        detector = make_unique<OpenCVDetector>();
-    }
-    return detector->loadModel(modelPath);
+    return publishEngine(engineName, lastModelPath);
 }
 
-void switchEngine(const string& engineName) {
-    if (engineName == "OpenCV") {
-        detector = make_unique<OpenCVDetector>();
-    } else if (engineName == "ONNXRuntime") {
-        detector = make_unique<OrtDetector>();
+void switchEngine(const string& name) {
+    if (name != "OpenCV" && name != "ONNXRuntime") return;
+
+    lock_guard<mutex> lock(loadMutex);
+    engineName = name;
+    publishEngine(engineName, lastModelPath);
+    if (engineName == "ONNXRuntime") {
         __android_log_print(ANDROID_LOG_INFO, "InferenceEngine", "ONNXRuntime engine successfully initialized");
     }
-    
-    if (!lastModelPath.empty()) {
-        detector->loadModel(lastModelPath);
+}
+
+void setHardwareBackend(const string& backendName) {
+    lock_guard<mutex> lock(detectorMutex);
+    hardwareBackend = backendName;
+    if (detector) {
+        detector->setBackend(backendName);
+    }
+}
+
+void setMaskUpsampling(bool enabled) {
+    lock_guard<mutex> lock(detectorMutex);
+    maskUpsampling = enabled;
+    if (detector) {
+        detector->setMaskUpsampling(enabled);
     }
 }
 
 vector<YoloResult> runYoloInference(long matAddr, float confThreshold, float iouThreshold, const vector<int>& allowedClasses) {
+    lock_guard<mutex> lock(detectorMutex);
     if (detector) {
         return detector->detect(getMat(matAddr), confThreshold, iouThreshold, allowedClasses);
     }
     return {};
 }
+
+vector<vector<YoloResult>> runYoloBatchInference(vector<cv::Mat>& frames, float confThreshold, float iouThreshold, const vector<int>& allowedClasses) {
+    lock_guard<mutex> lock(detectorMutex);
+    if (detector) {
+        return detector->detectBatch(frames, confThreshold, iouThreshold, allowedClasses);
+    }
+    return vector<vector<YoloResult>>(frames.size());
+}
@@ -6,8 +6,10 @@
 #include "yolo_result.h"
 #include "YoloDetector.h"
 
-extern std::unique_ptr<InferenceEngine> detector;
-
+// Model loads and engine switches run beside inference and block only to publish the new engine
 bool initYolo(const char* modelPath);
 void switchEngine(const std::string& engineName);
-std::vector<YoloResult> runYoloInference(long matAddr, float confThreshold, float iouThreshold, const std::vector<int>& allowedClasses);
\ No newline at end of file
+void setHardwareBackend(const std::string& backendName);
+void setMaskUpsampling(bool enabled);
+std::vector<YoloResult> runYoloInference(long matAddr, float confThreshold, float iouThreshold, const std::vector<int>& allowedClasses);
+std::vector<std::vector<YoloResult>> runYoloBatchInference(std::vector<cv::Mat>& frames, float confThreshold, float iouThreshold, const std::vector<int>& allowedClasses);
@@ -9,4 +9,10 @@ struct YoloResult {
     int y;
     int width;
     int height;
+
+    // Instance mask (segmentation models only). Row-major run lengths over a
+    // maskWidth x maskHeight grid spanning the box, starting with a background run.
+    int maskWidth = 0;
+    int maskHeight = 0;
+    std::vector<int> maskRle;
 };
@@ -2,9 +2,84 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <functional>
+#include <algorithm>
 #include "../ai/ai.h"
+#include "../ai/ModelCache.h"
 #include "../utils/utils.h"
 
+static std::vector<int> toClassList(JNIEnv *env, jintArray activeClassIds) {
+    std::vector<int> allowedClasses;
+    if (activeClassIds != nullptr) {
+        jsize len = env->GetArrayLength(activeClassIds);
+        jint *body = env->GetIntArrayElements(activeClassIds, 0);
+        for (int i = 0; i < len; i++) {
+            allowedClasses.push_back(body[i]);
+        }
+        env->ReleaseIntArrayElements(activeClassIds, body, 0);
+    }
+    return allowedClasses;
+}
+
+static std::string toJson(const std::vector<YoloResult>& results) {
+    std::stringstream json;
+    json << "[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "{";
+        json << '"' << "label" << '"' << ":" << '"' << results[i].label << '"' << ", ";
+        json << '"' << "conf" << '"' << ":" << results[i].confidence << ", ";
+        json << '"' << "box" << '"' << ":[" << results[i].x << "," << results[i].y << "," << results[i].width << "," << results[i].height << "]";
+        if (!results[i].maskRle.empty()) {
+            json << ", " << '"' << "mask" << '"' << ":{";
+            json << '"' << "w" << '"' << ":" << results[i].maskWidth << ", ";
+            json << '"' << "h" << '"' << ":" << results[i].maskHeight << ", ";
+            json << '"' << "rle" << '"' << ":[";
+            for (size_t r = 0; r < results[i].maskRle.size(); ++r) {
+                if (r > 0) json << ",";
+                json << results[i].maskRle[r];
+            }
+            json << "]}";
+        }
+        json << "}";
+    }
+    json << "]";
+    return json.str();
+}
+
+// Upper bound on images per locked inference call: ~5 MB of input tensor per image,
+// and engine switches / camera frames wait for at most one batch
+static const jint kMaxBatchSize = 8;
+
+// Runs inference in batches of batchSize (clamped to kMaxBatchSize) and hands each finished
+// batch to callback.onBatch(startIndex, jsonResults) before the next one is loaded.
+// The engine is locked per batch only, so camera frames interleave with a long run.
+static void streamBatches(JNIEnv *env, size_t total, jint batchSize, jfloat conf, jfloat iou, jintArray activeClassIds, jobject callback,
+                          const std::function<std::vector<cv::Mat>(size_t, size_t)>& loadBatch) {
+    std::vector<int> allowedClasses = toClassList(env, activeClassIds);
+    jclass callbackClass = env->GetObjectClass(callback);
+    jmethodID onBatch = env->GetMethodID(callbackClass, "onBatch", "(I[Ljava/lang/String;)V");
+    jclass stringClass = env->FindClass("java/lang/String");
+    if (onBatch == nullptr || stringClass == nullptr) return;
+
+    size_t step = (size_t)std::clamp(batchSize, (jint)1, kMaxBatchSize);
+    for (size_t start = 0; start < total; start += step) {
+        size_t count = std::min(step, total - start);
+        std::vector<cv::Mat> frames = loadBatch(start, count);
+        std::vector<std::vector<YoloResult>> results = runYoloBatchInference(frames, conf, iou, allowedClasses);
+
+        jobjectArray jsonArray = env->NewObjectArray((jsize)count, stringClass, nullptr);
+        for (size_t i = 0; i < count; ++i) {
+            jstring json = env->NewStringUTF(toJson(results[i]).c_str());
+            env->SetObjectArrayElement(jsonArray, (jsize)i, json);
+            env->DeleteLocalRef(json);
+        }
+        env->CallVoidMethod(callback, onBatch, (jint)start, jsonArray);
+        env->DeleteLocalRef(jsonArray);
+        if (env->ExceptionCheck()) return;
+    }
+}
+
 extern "C" JNIEXPORT jboolean JNICALL
 Java_com_mirror2922_ecvl_NativeLib_initYolo(JNIEnv *env, jobject, jstring model_path) {
     const char* path = env->GetStringUTFChars(model_path, nullptr);
@@ -23,37 +98,70 @@ Java_com_mirror2922_ecvl_NativeLib_setInferenceEngine(JNIEnv *env, jobject, jstr
 extern "C" JNIEXPORT void JNICALL
 Java_com_mirror2922_ecvl_NativeLib_setHardwareBackend(JNIEnv *env, jobject, jstring backend) {
     const char* b = env->GetStringUTFChars(backend, nullptr);
-    if (detector) {
-        detector->setBackend(std::string(b));
-    }
+    setHardwareBackend(std::string(b));
     env->ReleaseStringUTFChars(backend, b);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_mirror2922_ecvl_NativeLib_setMaskUpsampling(JNIEnv *env, jobject, jboolean enabled) {
+    setMaskUpsampling(enabled);
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_mirror2922_ecvl_NativeLib_getModelLoadStats(JNIEnv *env, jobject) {
+    ModelLoadStats stats = lastModelLoadStats();
+    std::stringstream json;
+    json << "{";
+    json << '"' << "engine" << '"' << ":" << '"' << stats.engine << '"' << ", ";
+    json << '"' << "loadMs" << '"' << ":" << stats.loadMs << ", ";
+    json << '"' << "rssDeltaKb" << '"' << ":" << stats.rssDeltaKb << ", ";
+    json << '"' << "peakDeltaKb" << '"' << ":" << stats.peakDeltaKb << ", ";
+    json << '"' << "cached" << '"' << ":" << (stats.fromCache ? "true" : "false");
+    json << "}";
+    return env->NewStringUTF(json.str().c_str());
+}
+
 extern "C" JNIEXPORT jstring JNICALL
 Java_com_mirror2922_ecvl_NativeLib_yoloInference(JNIEnv *env, jobject, jlong matAddr, jfloat conf, jfloat iou, jintArray activeClassIds) {
-    std::vector<int> allowedClasses;
-    if (activeClassIds != nullptr) {
-        jsize len = env->GetArrayLength(activeClassIds);
-        jint *body = env->GetIntArrayElements(activeClassIds, 0);
-        for (int i = 0; i < len; i++) {
-            allowedClasses.push_back(body[i]);
+    std::vector<int> allowedClasses = toClassList(env, activeClassIds);
+    std::vector<YoloResult> results = runYoloInference(matAddr, conf, iou, allowedClasses);
+    return env->NewStringUTF(toJson(results).c_str());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_mirror2922_ecvl_NativeLib_yoloBatchInference(JNIEnv *env, jobject, jlongArray matAddrs, jint batchSize, jfloat conf, jfloat iou, jintArray activeClassIds, jobject callback) {
+    jsize len = env->GetArrayLength(matAddrs);
+    std::vector<jlong> addrs(len);
+    env->GetLongArrayRegion(matAddrs, 0, len, addrs.data());
+
+    streamBatches(env, addrs.size(), batchSize, conf, iou, activeClassIds, callback, [&](size_t start, size_t count) {
+        std::vector<cv::Mat> frames;
+        for (size_t i = start; i < start + count; ++i) {
+            frames.push_back(getMat(addrs[i]));
         }
-        env->ReleaseIntArrayElements(activeClassIds, body, 0);
-    }
+        return frames;
+    });
+}
 
-    std::vector<YoloResult> results = runYoloInference(matAddr, conf, iou, allowedClasses);
-    
-    std::stringstream json;
-    json << "[";
-    for (size_t i = 0; i < results.size(); ++i) {
-        if (i > 0) json << ",";
-        json << "{";
-        json << '"' << "label" << '"' << ":" << '"' << results[i].label << '"' << ", ";
-        json << '"' << "conf" << '"' << ":" << results[i].confidence << ", ";
-        json << '"' << "box" << '"' << ":[" << results[i].x << "," << results[i].y << "," << results[i].width << "," << results[i].height << "]";
-        json << "}";
+extern "C" JNIEXPORT void JNICALL
+Java_com_mirror2922_ecvl_NativeLib_yoloBatchInferenceFiles(JNIEnv *env, jobject, jobjectArray imagePaths, jint batchSize, jfloat conf, jfloat iou, jintArray activeClassIds, jobject callback) {
+    jsize len = env->GetArrayLength(imagePaths);
+    std::vector<std::string> paths;
+    for (jsize i = 0; i < len; ++i) {
+        auto jpath = (jstring)env->GetObjectArrayElement(imagePaths, i);
+        if (jpath == nullptr) {
+            paths.emplace_back();
+            continue;
+        }
+        const char* path = env->GetStringUTFChars(jpath, nullptr);
+        if (path == nullptr) return; // OutOfMemoryError is pending
+        paths.emplace_back(path);
+        env->ReleaseStringUTFChars(jpath, path);
+        env->DeleteLocalRef(jpath);
     }
-    json << "]";
-    
-    return env->NewStringUTF(json.str().c_str());
+
+    // Files are decoded one batch at a time so a whole gallery never sits in memory
+    streamBatches(env, paths.size(), batchSize, conf, iou, activeClassIds, callback, [&](size_t start, size_t count) {
+        return loadImagesRgba(std::vector<std::string>(paths.begin() + start, paths.begin() + start + count));
+    });
 }
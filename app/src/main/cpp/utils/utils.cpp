@@ -3,3 +3,14 @@
 cv::Mat& getMat(jlong addr) {
     return *(cv::Mat*)addr;
 }
+
+std::vector<cv::Mat> loadImagesRgba(const std::vector<std::string>& paths) {
+    std::vector<cv::Mat> images(paths.size());
+    cv::parallel_for_(cv::Range(0, (int)paths.size()), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            cv::Mat bgr = cv::imread(paths[i], cv::IMREAD_COLOR);
+            if (!bgr.empty()) cv::cvtColor(bgr, images[i], cv::COLOR_BGR2RGBA);
+        }
+    });
+    return images;
+}
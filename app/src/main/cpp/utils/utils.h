@@ -1,5 +1,10 @@
 #pragma once
 #include <jni.h>
 #include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
 
 cv::Mat& getMat(jlong addr);
+
+// Decodes image files in parallel as RGBA, matching camera frames; unreadable files stay empty
+std::vector<cv::Mat> loadImagesRgba(const std::vector<std::string>& paths);
@@ -21,11 +21,24 @@ class NativeLib {
     external fun recognizeColorBlock(matAddr: Long): String
     
     // AI
+    // initYolo / setInferenceEngine load the model on the calling thread (seconds on a cold
+    // start), then wait for the in-flight frame or batch (<= 8 images) before switching.
+    // The setters below also wait for the in-flight frame or batch. Prefer a background thread.
     external fun initYolo(modelPath: String): Boolean
     external fun setInferenceEngine(engine: String)
     external fun setHardwareBackend(backend: String)
+    external fun setMaskUpsampling(enabled: Boolean)
+    external fun getModelLoadStats(): String
     external fun yoloInference(matAddr: Long, confidence: Float, iou: Float, activeClassIds: IntArray): String
 
+    // Batched AI: results arrive per batch as one JSON string per input, in input order.
+    // batchSize is clamped to 1..8; blocks the calling thread until every batch is done.
+    fun interface BatchCallback {
+        fun onBatch(startIndex: Int, results: Array<String>)
+    }
+    external fun yoloBatchInference(matAddrs: LongArray, batchSize: Int, confidence: Float, iou: Float, activeClassIds: IntArray, callback: BatchCallback)
+    external fun yoloBatchInferenceFiles(imagePaths: Array<String>, batchSize: Int, confidence: Float, iou: Float, activeClassIds: IntArray, callback: BatchCallback)
+
     // Efficient conversion
     external fun yuvToRgba(
         yPlane: java.nio.ByteBuffer, yRowStride: Int,
@@ -56,6 +56,10 @@ object ModelManager {
     }
 
     fun deleteModel(context: Context, fileName: String): Boolean {
+        // Pre-optimized copies written next to the model by the native model cache,
+        // with their .key sidecars and any .tmp left by an interrupted first load
+        context.filesDir.listFiles { f -> f.name.startsWith("$fileName.") && f.name.contains(".ort") }
+            ?.forEach { it.delete() }
         return File(context.filesDir, fileName).delete()
     }
 }
\ No newline at end of file